@@ -2,11 +2,45 @@
 #include <stdlib.h>
 #include <math.h>
 #include <float.h>
+#include <limits.h>
 #include <stdbool.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <stdint.h>
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
+// -DDBSCAN_BENCH builds the parallel scaling and frame cache benchmarks instead
+// of the single frame demo; they need room for large clouds and no tracing.
+#ifdef DBSCAN_BENCH
+#define DBSCAN_QUIET
+#endif
+
+#ifndef MAX_POINTS
+#ifdef DBSCAN_BENCH
+#define MAX_POINTS 4096
+#else
 #define MAX_POINTS 50
+#endif
+#endif
 #define UNVISITED -1
 #define NOISE -2
+#define DBSCAN_MAX_THREADS 16
+#define NEIGHBOR_MIN_SNR 25
+#define DEFAULT_DOPPLER_GATE 0.2f
+
+#ifdef DBSCAN_QUIET
+#define DBSCAN_LOG(...) ((void)0)
+#else
+#define DBSCAN_LOG(...) printf(__VA_ARGS__)
+#endif
 
 typedef struct {
     union {
@@ -32,66 +66,611 @@ typedef struct {
     int visited[MAX_POINTS];
 } DBSCANResult;
 
+// Azimuth trig lookup. The radar reports azimuth on a 1/1024 rad grid,
+// converted to degrees (38.21583557 deg is bin 683), so sin/cos for a reported
+// angle is a single table load. Angles off the grid are interpolated between
+// the two nearest bins; anything outside +-90 deg falls back to sinf/cosf.
+#define AZIMUTH_BINS_PER_RAD 1024
+#define AZIMUTH_LUT_HALF_BINS 1609
+#define AZIMUTH_ON_GRID_TOL 1e-3f
+
+// The tables (2 x 3219 floats, about 25 KB) sit in .bss outside the scratch
+// arena; main and the benchmark print their size next to the arena peak.
+static float azimuthSinTable[2 * AZIMUTH_LUT_HALF_BINS + 1];
+static float azimuthCosTable[2 * AZIMUTH_LUT_HALF_BINS + 1];
+static bool azimuthTrigReady = false;
+
+void azimuthTrigInit(void) {
+    if (azimuthTrigReady) return;
+    for (int k = -AZIMUTH_LUT_HALF_BINS; k <= AZIMUTH_LUT_HALF_BINS; k++) {
+        double rad = (double) k / AZIMUTH_BINS_PER_RAD;
+        azimuthSinTable[k + AZIMUTH_LUT_HALF_BINS] = (float) sin(rad);
+        azimuthCosTable[k + AZIMUTH_LUT_HALF_BINS] = (float) cos(rad);
+    }
+    azimuthTrigReady = true;
+}
+
+static inline void azimuthSinCos(float azimuthDeg, float *sinOut, float *cosOut) {
+    float bin = azimuthDeg * (float)(AZIMUTH_BINS_PER_RAD * M_PI / 180.0);
+    if (!azimuthTrigReady || !(fabsf(bin) < AZIMUTH_LUT_HALF_BINS)) {
+        float azimuth_rad = azimuthDeg * (M_PI / 180.0f);
+        *sinOut = sinf(azimuth_rad);
+        *cosOut = cosf(azimuth_rad);
+        return;
+    }
+    int lower = (int) floorf(bin);
+    float frac = bin - lower;
+    int idx = lower + AZIMUTH_LUT_HALF_BINS;
+    if (frac < AZIMUTH_ON_GRID_TOL) {
+        *sinOut = azimuthSinTable[idx];
+        *cosOut = azimuthCosTable[idx];
+    } else if (frac > 1.0f - AZIMUTH_ON_GRID_TOL) {
+        *sinOut = azimuthSinTable[idx + 1];
+        *cosOut = azimuthCosTable[idx + 1];
+    } else {
+        *sinOut = azimuthSinTable[idx] + frac * (azimuthSinTable[idx + 1] - azimuthSinTable[idx]);
+        *cosOut = azimuthCosTable[idx] + frac * (azimuthCosTable[idx + 1] - azimuthCosTable[idx]);
+    }
+}
+
+#define ARENA_ALIGN 8
+
+// Bump allocator for per-frame scratch. Memory is taken once at init and
+// handed back in one go by treeFilterBeginFrame(), so nothing is freed mid-frame.
+typedef struct {
+    unsigned char *base;
+    size_t capacity;
+    size_t used;
+    size_t peak;
+} ScratchArena;
+
+// Cross-frame cache of the neighbour structure. High-SNR points are keyed on
+// their quantized (range bin, azimuth bin) and compared exactly on range,
+// azimuth and gate flag, so repeated stationary returns map to the same key.
+// Each key keeps the keys within eps (its links) and its union-find parent;
+// a key seen last frame takes both over, patched with the keys that arrived
+// or left, and only new keys scan the frame. Low-SNR points are never core
+// nor anyone's neighbour, so they are always NOISE and get no key.
+#define FRAME_CACHE_RANGE_BINS_PER_M 64 // radar range resolution is 1/64 m
+#define FRAME_CACHE_SLOTS(maxPoints) (2 * (maxPoints) + 1)
+#ifndef FRAME_CACHE_LINKS_PER_KEY
+#define FRAME_CACHE_LINKS_PER_KEY 32    // average links budget; denser frames run uncached
+#endif
+#define FRAME_CACHE_LINKS(maxPoints) \
+    ((maxPoints) * ((maxPoints) - 1 < FRAME_CACHE_LINKS_PER_KEY ? (maxPoints) - 1 : FRAME_CACHE_LINKS_PER_KEY))
+
+typedef struct {
+    float range;
+    float azimuth;
+    float x;
+    float y;
+    unsigned char gated;
+    unsigned char core;
+    unsigned char touched;              // new or recounted; its component is rebuilt
+    unsigned char dirty;                // per root: component can't be carried to the next frame
+    int slot;                           // hash slot, so a table clears in O(keys)
+    int multiplicity;                   // points in the frame with this key
+    int firstPoint;                     // lowest point index with this key
+    int neighborCount;                  // gated neighbours within eps, excluding itself
+    int prevKey;                        // same key in the previous frame, -1 if new
+    int nextKey;                        // same key in the following frame, -1 if it left
+    int linkStart;                      // keys within eps are links[linkStart..+linkCount)
+    int linkCount;
+    int parent;                         // union-find over gated core keys
+    int firstInComponent;               // per root: lowest point index of the component
+    int claim;                          // per root: point that starts the component's cluster
+    int label;                          // cluster id of firstPoint (gated core: of the component)
+} FrameCacheKey;
+
+typedef struct {
+    FrameCacheKey *keys;                // maxPoints
+    int *slots;                         // FRAME_CACHE_SLOTS(maxPoints), -1 when free
+    int *links;                         // FRAME_CACHE_LINKS(maxPoints)
+    int numKeys;
+    int numLinks;
+} FrameCacheTable;
+
+typedef struct {
+    FrameCacheTable tables[2];          // last frame's and this frame's, swapped per frame
+    int current;                        // index of last frame's table
+    float eps;
+    float dopplerGate;
+    int minSamples;                     // carried components only hold for the same minSamples
+    bool valid;
+    unsigned long reusedKeys;           // links taken over from the previous frame
+    unsigned long queriedKeys;          // links found by scanning the frame
+    unsigned long carriedKeys;          // component membership carried over
+    unsigned long uncachedFrames;       // frames over the links budget
+} FrameCache;
+
+typedef struct {
+    ScratchArena arena;
+    int maxPoints;
+    bool ownsBuffer;
+    float dopplerGate;                  // |doppler| limit for neighbours, see selectAdaptiveParams
+    bool cacheEnabled;                  // pointDbscan reuses results of the previous frame
+    FrameCache frameCache;
+    void *buffer;
+} TreeFilterContext;
+
+static size_t arenaAlignUp(size_t bytes) {
+    return (bytes + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+}
+
+void *arenaAlloc(ScratchArena *arena, size_t bytes) {
+    size_t size = arenaAlignUp(bytes);
+    if (size > arena->capacity - arena->used) return NULL;
+    void *ptr = arena->base + arena->used;
+    arena->used += size;
+    if (arena->used > arena->peak) arena->peak = arena->used;
+    return ptr;
+}
+
+// Worst-case scratch for one frame of maxPoints points:
+// pointDbscan   - seed queue, expansion buffer, queue marks, coordinates
+// getLargestCluster - cluster counts (ids 1..maxPoints), sort order, candidate copy
+// pointDbscanParallel - coordinates, gate/core flags, union-find parents,
+//                       claims, cluster ids and a grid of at most
+//                       4 * maxPoints cells (only one of the two DBSCAN
+//                       variants runs per frame)
+size_t treeFilterScratchBytes(int maxPoints) {
+    size_t pointInts = arenaAlignUp(maxPoints * sizeof(int));
+    // with the frame cache, pointDbscan only needs each point's key and the
+    // list of new keys, and hands both back before falling back to the queue
+    size_t sequential = 3 * pointInts
+                      + 2 * arenaAlignUp(maxPoints * sizeof(float));
+    size_t parallel = 2 * arenaAlignUp(maxPoints * sizeof(float))
+                    + 2 * arenaAlignUp(maxPoints)
+                    + 5 * pointInts
+                    + arenaAlignUp((4 * (size_t)maxPoints + 2) * sizeof(int));
+    return (parallel > sequential ? parallel : sequential)
+         + arenaAlignUp((maxPoints + 1) * sizeof(int))
+         + pointInts
+         + arenaAlignUp(maxPoints * sizeof(GTRACK_measurementPoint));
+}
+
+// Frame cache state that lives across frames, kept in front of the arena.
+size_t treeFilterCacheBytes(int maxPoints) {
+    return 2 * (arenaAlignUp(maxPoints * sizeof(FrameCacheKey))
+              + arenaAlignUp(FRAME_CACHE_SLOTS(maxPoints) * sizeof(int))
+              + arenaAlignUp(FRAME_CACHE_LINKS(maxPoints) * sizeof(int)));
+}
+
+size_t treeFilterBufferBytes(int maxPoints) {
+    return treeFilterCacheBytes(maxPoints) + treeFilterScratchBytes(maxPoints);
+}
+
+// buffer may be NULL, in which case the cache and arena are malloc'ed once here.
+// Otherwise it must hold at least treeFilterBufferBytes(maxPoints) bytes
+// and be ARENA_ALIGN aligned (e.g. a static array in firmware).
+// Fails if maxPoints is outside 1..MAX_POINTS, the size of DBSCANResult.
+// ctx is left empty on failure, so treeFilterFree is always safe to call.
+bool treeFilterInit(TreeFilterContext *ctx, int maxPoints, void *buffer, size_t bufferBytes) {
+    memset(ctx, 0, sizeof(*ctx));
+    if (maxPoints < 1 || maxPoints > MAX_POINTS) return false;
+    size_t needed = treeFilterBufferBytes(maxPoints);
+    bool ownsBuffer = (buffer == NULL);
+    if (ownsBuffer) {
+        buffer = malloc(needed);
+        bufferBytes = needed;
+        if (buffer == NULL) return false;
+    } else if (bufferBytes < needed) {
+        return false;
+    }
+    ctx->maxPoints = maxPoints;
+    ctx->ownsBuffer = ownsBuffer;
+    ctx->dopplerGate = DEFAULT_DOPPLER_GATE;
+    ctx->cacheEnabled = false;
+    ctx->buffer = buffer;
+    azimuthTrigInit();
+
+    size_t cacheBytes = treeFilterCacheBytes(maxPoints);
+    unsigned char *cursor = (unsigned char*) buffer;
+    FrameCache *cache = &ctx->frameCache;
+    for (int t = 0; t < 2; t++) {
+        FrameCacheTable *table = &cache->tables[t];
+        table->keys = (FrameCacheKey*) cursor;
+        cursor += arenaAlignUp(maxPoints * sizeof(FrameCacheKey));
+        table->slots = (int*) cursor;
+        cursor += arenaAlignUp(FRAME_CACHE_SLOTS(maxPoints) * sizeof(int));
+        table->links = (int*) cursor;
+        cursor += arenaAlignUp(FRAME_CACHE_LINKS(maxPoints) * sizeof(int));
+        memset(table->slots, 0xff, FRAME_CACHE_SLOTS(maxPoints) * sizeof(int));
+    }
+
+    ctx->arena.base = (unsigned char*) buffer + cacheBytes;
+    ctx->arena.capacity = bufferBytes - cacheBytes;
+    ctx->arena.used = 0;
+    ctx->arena.peak = 0;
+    return true;
+}
+
+void treeFilterFree(TreeFilterContext *ctx) {
+    if (ctx->ownsBuffer) free(ctx->buffer);
+    ctx->buffer = NULL;
+    ctx->ownsBuffer = false;
+    ctx->arena.base = NULL;
+    ctx->arena.capacity = 0;
+    ctx->frameCache.valid = false;
+}
+
+void treeFilterBeginFrame(TreeFilterContext *ctx) {
+    ctx->arena.used = 0;
+}
+
+
+static inline void toCartesian(const GTRACK_measurementPoint *p, float *x, float *y) {
+    float sinAz, cosAz;
+    azimuthSinCos(p->vector.azimuth, &sinAz, &cosAz);
+    *x = p->vector.range * sinAz;
+    *y = p->vector.range * cosAz;
+}
+
+static inline float distanceXY(float x1, float y1, float x2, float y2) {
+    return sqrtf(powf(x1 - x2, 2) + powf(y1 - y2, 2));
+}
 
 float calculateDistance(GTRACK_measurementPoint p1, GTRACK_measurementPoint p2) {
-    float azimuth1_rad = p1.vector.azimuth * (M_PI / 180.0f);
-    float azimuth2_rad = p2.vector.azimuth * (M_PI / 180.0f);
-    return sqrtf(
-        powf(p1.vector.range * sinf(azimuth1_rad) - p2.vector.range * sinf(azimuth2_rad), 2) +
-        powf(p1.vector.range * cosf(azimuth1_rad) - p2.vector.range * cosf(azimuth2_rad), 2));
+    float x1, y1, x2, y2;
+    toCartesian(&p1, &x1, &y1);
+    toCartesian(&p2, &x2, &y2);
+    return distanceXY(x1, y1, x2, y2);
+}
+
+// Points that may be pulled into a cluster as neighbours.
+static inline bool passesNeighborGate(const GTRACK_measurementPoint *p, float dopplerGate) {
+    return p->snr >= NEIGHBOR_MIN_SNR && fabsf(p->vector.doppler) < dopplerGate;
 }
 
-int findNeighbors(GTRACK_measurementPoint *points, int numPoints, int index, float eps, int *neighbors) {
+// xs/ys are the points' Cartesian coordinates, converted once per frame.
+int findNeighbors(GTRACK_measurementPoint *points, const float *xs, const float *ys, int numPoints, int index, float eps, float dopplerGate, int *neighbors) {
     int count = 0;
     for (int i = 0; i < numPoints; i++) {
-        if (i != index && points[i].snr >= 25 && abs(points[i].vector.doppler) < 0.2 && calculateDistance(points[index], points[i]) <= eps) {
-            printf(" with %d point dis is : %.2f \n", i, calculateDistance(points[index], points[i]));
+        if (i == index || !passesNeighborGate(&points[i], dopplerGate)) continue;
+        float distance = distanceXY(xs[index], ys[index], xs[i], ys[i]);
+        if (distance <= eps) {
+            DBSCAN_LOG(" with %d point dis is : %.2f \n", i, distance);
             neighbors[count++] = i;
         }
     }
-    printf(" neighborCount : %d\n", count);
+    DBSCAN_LOG(" neighborCount : %d\n", count);
     return count;
 }
 
-void pointDbscan(GTRACK_measurementPoint *points, int numPoints, float eps, int minSamples, DBSCANResult *result) {
+static unsigned int frameCacheHash(float range, float azimuth, int numSlots) {
+    long rangeBin = lroundf(range * FRAME_CACHE_RANGE_BINS_PER_M);
+    long azimuthBin = lroundf(azimuth * (float)(AZIMUTH_BINS_PER_RAD * M_PI / 180.0));
+    unsigned int h = (unsigned int) rangeBin * 2654435761u ^ (unsigned int) azimuthBin * 40503u;
+    return h % (unsigned int) numSlots;
+}
+
+// Returns the key (range, azimuth, gated) of the table, or -1. With insert set,
+// a missing key is appended instead; the slots have 2x headroom over the keys.
+static int frameCacheFind(FrameCacheTable *table, int numSlots, float range, float azimuth, unsigned char gated, bool insert) {
+    int slot = (int) frameCacheHash(range, azimuth, numSlots);
+    for (int probe = 0; probe < numSlots; probe++) {
+        int k = table->slots[slot];
+        if (k < 0) {
+            if (!insert) return -1;
+            k = table->numKeys++;
+            FrameCacheKey *key = &table->keys[k];
+            memset(key, 0, sizeof(*key));
+            key->range = range;
+            key->azimuth = azimuth;
+            key->gated = gated;
+            key->slot = slot;
+            key->prevKey = -1;
+            key->nextKey = -1;
+            table->slots[slot] = k;
+            return k;
+        }
+        FrameCacheKey *key = &table->keys[k];
+        if (key->range == range && key->azimuth == azimuth && key->gated == gated) return k;
+        if (++slot == numSlots) slot = 0;
+    }
+    return -1;
+}
+
+static int frameCacheRoot(FrameCacheKey *keys, int k) {
+    while (keys[k].parent != k) {
+        keys[k].parent = keys[keys[k].parent].parent;
+        k = keys[k].parent;
+    }
+    return k;
+}
+
+static void frameCacheUnion(FrameCacheKey *keys, int a, int b) {
+    a = frameCacheRoot(keys, a);
+    b = frameCacheRoot(keys, b);
+    if (a < b) keys[b].parent = a;
+    else if (b < a) keys[a].parent = b;
+}
+
+// Labels the frame from the cached neighbour structure, following the rules
+// listed at pointDbscanParallel so the result matches pointDbscan:
+//  - links: a key seen last frame keeps its links to keys still present and
+//    gains the new keys within eps; only new keys scan the frame
+//  - counts and core flags are summed over the links
+//  - components: an unchanged gated core key whose last component lost no key
+//    and had no key recounted keeps its union-find parent; only the rebuilt
+//    keys re-run their unions
+//  - cluster ids are handed out in one pass over the points
+// Returns false, leaving the cache invalid, if the links do not fit the budget
+// or the arena runs out; the caller then clusters the frame without the cache.
+static bool frameCacheCluster(TreeFilterContext *ctx, GTRACK_measurementPoint *points, int numPoints, float eps, int minSamples, DBSCANResult *result) {
+    FrameCache *cache = &ctx->frameCache;
+    FrameCacheTable *prev = &cache->tables[cache->current];
+    FrameCacheTable *cur = &cache->tables[cache->current ^ 1];
+    int numSlots = FRAME_CACHE_SLOTS(ctx->maxPoints);
+    int maxLinks = FRAME_CACHE_LINKS(ctx->maxPoints);
+    bool valid = cache->valid && cache->eps == eps && cache->dopplerGate == ctx->dopplerGate;
+    bool carry = valid && cache->minSamples == minSamples;
+    cache->valid = false;
+
+    int *keyOf = (int*) arenaAlloc(&ctx->arena, numPoints * sizeof(int));
+    int *newKeys = (int*) arenaAlloc(&ctx->arena, numPoints * sizeof(int));
+    if (keyOf == NULL || newKeys == NULL) return false;
+
+    for (int k = 0; k < cur->numKeys; k++) cur->slots[cur->keys[k].slot] = -1;
+    cur->numKeys = 0;
+    cur->numLinks = 0;
+    for (int i = 0; i < numPoints; i++) {
+        keyOf[i] = -1;
+        if (points[i].snr < NEIGHBOR_MIN_SNR) continue;
+        int k = frameCacheFind(cur, numSlots, points[i].vector.range, points[i].vector.azimuth,
+                               passesNeighborGate(&points[i], ctx->dopplerGate), true);
+        FrameCacheKey *key = &cur->keys[k];
+        if (key->multiplicity++ == 0) {
+            key->firstPoint = i;
+            toCartesian(&points[i], &key->x, &key->y);
+        }
+        keyOf[i] = k;
+    }
+    FrameCacheKey *keys = cur->keys;
+    int numKeys = cur->numKeys;
+
+    int numNew = 0;
+    for (int k = 0; k < numKeys; k++) {
+        if (valid) keys[k].prevKey = frameCacheFind(prev, numSlots, keys[k].range, keys[k].azimuth, keys[k].gated, false);
+        if (keys[k].prevKey >= 0) {
+            prev->keys[keys[k].prevKey].nextKey = k;
+        } else {
+            newKeys[numNew++] = k;
+        }
+    }
+
+    // New keys scan every key; the old ones count the links they gain.
+    for (int n = 0; n < numNew; n++) {
+        FrameCacheKey *key = &keys[newKeys[n]];
+        key->linkStart = cur->numLinks;
+        for (int k = 0; k < numKeys; k++) {
+            if (k == newKeys[n] || distanceXY(key->x, key->y, keys[k].x, keys[k].y) > eps) continue;
+            if (cur->numLinks == maxLinks) return false;
+            cur->links[cur->numLinks++] = k;
+            if (keys[k].prevKey >= 0) keys[k].linkCount++;
+        }
+        key->linkCount = cur->numLinks - key->linkStart;
+    }
+    // Old keys take over their links to keys still present, leaving room for
+    // the gained ones, which are then filled in from the new keys' side.
+    for (int k = 0; k < numKeys; k++) {
+        if (keys[k].prevKey < 0) continue;
+        const FrameCacheKey *old = &prev->keys[keys[k].prevKey];
+        int gained = keys[k].linkCount;
+        if (cur->numLinks + old->linkCount + gained > maxLinks) return false;
+        keys[k].linkStart = cur->numLinks;
+        keys[k].linkCount = 0;
+        for (int l = old->linkStart; l < old->linkStart + old->linkCount; l++) {
+            int next = prev->keys[prev->links[l]].nextKey;
+            if (next >= 0) cur->links[cur->numLinks + keys[k].linkCount++] = next;
+        }
+        cur->numLinks += keys[k].linkCount + gained;
+    }
+    for (int n = 0; n < numNew; n++) {
+        const FrameCacheKey *key = &keys[newKeys[n]];
+        for (int l = key->linkStart; l < key->linkStart + key->linkCount; l++) {
+            FrameCacheKey *other = &keys[cur->links[l]];
+            if (other->prevKey >= 0) cur->links[other->linkStart + other->linkCount++] = newKeys[n];
+        }
+    }
+    cache->reusedKeys += numKeys - numNew;
+    cache->queriedKeys += numNew;
+
+    for (int k = 0; k < numKeys; k++) {
+        FrameCacheKey *key = &keys[k];
+        int count = key->gated ? key->multiplicity - 1 : 0;
+        for (int l = key->linkStart; l < key->linkStart + key->linkCount; l++) {
+            if (keys[cur->links[l]].gated) count += keys[cur->links[l]].multiplicity;
+        }
+        key->neighborCount = count;
+        key->core = count >= minSamples;
+        key->touched = !carry || key->prevKey < 0 || count != prev->keys[key->prevKey].neighborCount;
+    }
+
+    // A component of last frame is carried over only if none of its keys left
+    // or was recounted: unchanged counts keep the cores and the links between them.
+    if (carry) {
+        for (int p = 0; p < prev->numKeys; p++) {
+            const FrameCacheKey *old = &prev->keys[p];
+            if (!old->gated || !old->core) continue;
+            if (old->nextKey < 0 || keys[old->nextKey].touched) prev->keys[old->parent].dirty = 1;
+        }
+    }
+    for (int k = 0; k < numKeys; k++) {
+        FrameCacheKey *key = &keys[k];
+        key->parent = k;
+        if (key->touched || !key->gated || !key->core) continue;
+        const FrameCacheKey *root = &prev->keys[prev->keys[key->prevKey].parent];
+        if (root->dirty) {
+            key->touched = 1;
+        } else {
+            key->parent = root->nextKey;
+            cache->carriedKeys++;
+        }
+    }
+    for (int k = 0; k < numKeys; k++) {
+        if (!keys[k].touched || !keys[k].gated || !keys[k].core) continue;
+        for (int l = keys[k].linkStart; l < keys[k].linkStart + keys[k].linkCount; l++) {
+            int other = cur->links[l];
+            if (keys[other].gated && keys[other].core) frameCacheUnion(keys, k, other);
+        }
+    }
+
+    // A component's cluster starts at its lowest point, or joins the cluster of
+    // an earlier non-gated core within eps of it.
+    for (int k = 0; k < numKeys; k++) {
+        keys[k].firstInComponent = INT_MAX;
+        keys[k].label = 0;
+    }
+    for (int k = 0; k < numKeys; k++) {
+        if (!keys[k].gated || !keys[k].core) continue;
+        FrameCacheKey *root = &keys[frameCacheRoot(keys, k)];
+        if (keys[k].firstPoint < root->firstInComponent) root->firstInComponent = keys[k].firstPoint;
+        root->claim = root->firstInComponent;
+    }
+    for (int k = 0; k < numKeys; k++) {
+        if (keys[k].gated || !keys[k].core) continue;
+        for (int l = keys[k].linkStart; l < keys[k].linkStart + keys[k].linkCount; l++) {
+            int other = cur->links[l];
+            if (!keys[other].gated || !keys[other].core) continue;
+            FrameCacheKey *root = &keys[frameCacheRoot(keys, other)];
+            if (keys[k].firstPoint < root->claim) root->claim = keys[k].firstPoint;
+        }
+    }
+
+    int clusterId = 0;
+    for (int i = 0; i < numPoints; i++) {
+        int k = keyOf[i];
+        result->visited[i] = 1;
+        result->cluster[i] = NOISE;
+        if (k < 0 || !keys[k].core) continue;
+        if (!keys[k].gated) {
+            result->cluster[i] = ++clusterId;
+            if (i == keys[k].firstPoint) keys[k].label = clusterId;
+            continue;
+        }
+        FrameCacheKey *root = &keys[frameCacheRoot(keys, k)];
+        if (root->label == 0) {
+            root->label = root->claim == root->firstInComponent ? ++clusterId : result->cluster[root->claim];
+        }
+        result->cluster[i] = root->label;
+    }
+    // A gated non-core point joins the lowest-id cluster with a core within eps.
+    for (int k = 0; k < numKeys; k++) {
+        if (!keys[k].gated || keys[k].core) continue;
+        int label = NOISE;
+        for (int l = keys[k].linkStart; l < keys[k].linkStart + keys[k].linkCount; l++) {
+            int other = cur->links[l];
+            if (!keys[other].core) continue;
+            int id = keys[other].gated ? keys[frameCacheRoot(keys, other)].label : keys[other].label;
+            if (label == NOISE || id < label) label = id;
+        }
+        keys[k].label = label;
+    }
+    for (int i = 0; i < numPoints; i++) {
+        int k = keyOf[i];
+        if (k >= 0 && keys[k].gated && !keys[k].core) result->cluster[i] = keys[k].label;
+    }
+
+    for (int k = 0; k < numKeys; k++) keys[k].parent = frameCacheRoot(keys, k);
+    cache->current ^= 1;
+    cache->eps = eps;
+    cache->dopplerGate = ctx->dopplerGate;
+    cache->minSamples = minSamples;
+    cache->valid = true;
+    return true;
+}
+
+// Used when a frame cannot be clustered, so callers never see stale labels.
+static void markAllNoise(DBSCANResult *result, int numPoints) {
+    if (numPoints > MAX_POINTS) numPoints = MAX_POINTS;
+    for (int i = 0; i < numPoints; i++) {
+        result->visited[i] = 1;
+        result->cluster[i] = NOISE;
+    }
+}
+
+// Returns false (with every point marked NOISE) if the frame exceeds the
+// context's maxPoints or the scratch arena runs out.
+bool pointDbscan(TreeFilterContext *ctx, GTRACK_measurementPoint *points, int numPoints, float eps, int minSamples, DBSCANResult *result) {
     int clusterId = 0;
-    int neighbors[MAX_POINTS];
 
+    if (numPoints > ctx->maxPoints) {
+        printf("pointDbscan: %d points exceeds context limit %d\n", numPoints, ctx->maxPoints);
+        markAllNoise(result, numPoints);
+        return false;
+    }
+
+    // The frame cache labels the frame from last frame's neighbour structure;
+    // over its links budget the frame is clustered here instead.
+    if (ctx->cacheEnabled) {
+        size_t arenaMark = ctx->arena.used;
+        if (frameCacheCluster(ctx, points, numPoints, eps, minSamples, result)) return true;
+        ctx->arena.used = arenaMark;
+        ctx->frameCache.uncachedFrames++;
+        DBSCAN_LOG("frame cache over budget, clustering uncached\n");
+    }
 
     for (int i = 0; i < numPoints; i++) {        
         result->visited[i] = UNVISITED;
         result->cluster[i] = UNVISITED;
-        printf("init %d %d %d \n", i, result->visited[i], result->cluster[i]);
+        DBSCAN_LOG("init %d %d %d \n", i, result->visited[i], result->cluster[i]);
+    }
+
+    // Seed queue holds each point at most once per cluster (queuedIn records the
+    // last cluster that queued it), so it never grows past numPoints.
+    int *neighbors = (int*) arenaAlloc(&ctx->arena, numPoints * sizeof(int));
+    int *nextNeighbors = (int*) arenaAlloc(&ctx->arena, numPoints * sizeof(int));
+    int *queuedIn = (int*) arenaAlloc(&ctx->arena, numPoints * sizeof(int));
+    if (neighbors == NULL || nextNeighbors == NULL || queuedIn == NULL) {
+        printf("pointDbscan: scratch arena exhausted\n");
+        markAllNoise(result, numPoints);
+        return false;
+    }
+    memset(queuedIn, 0, numPoints * sizeof(int));
+
+    float *xs = (float*) arenaAlloc(&ctx->arena, numPoints * sizeof(float));
+    float *ys = (float*) arenaAlloc(&ctx->arena, numPoints * sizeof(float));
+    if (xs == NULL || ys == NULL) {
+        printf("pointDbscan: scratch arena exhausted\n");
+        markAllNoise(result, numPoints);
+        return false;
     }
+    for (int i = 0; i < numPoints; i++) toCartesian(&points[i], &xs[i], &ys[i]);
 
     for (int i = 0; i < numPoints; i++) {
-        printf("points %d : it is visited : %d \n", i, result->visited[i]);
+        DBSCAN_LOG("points %d : it is visited : %d \n", i, result->visited[i]);
         if (result->visited[i] != UNVISITED) continue;
 
-        printf("go head \n");
+        DBSCAN_LOG("go head \n");
         result->visited[i] = 1;
-        int neighborCount = findNeighbors(points, numPoints, i, eps, neighbors);        
+        int neighborCount = findNeighbors(points, xs, ys, numPoints, i, eps, ctx->dopplerGate, neighbors);
 
         // if (neighborCount < minSamples  || points[i].snr < 25 || points[i].snr >= 30  || abs(points[i].doppler) >= 0.2f) {   // 20250217 update
-        if (neighborCount < minSamples || points[i].snr < 25) {
-            printf("    points %d : is noise\n", i);
+        if (neighborCount < minSamples || points[i].snr < NEIGHBOR_MIN_SNR) {
+            DBSCAN_LOG("    points %d : is noise\n", i);
             result->cluster[i] = NOISE;
         } 
         else 
         {            
             clusterId++;
             result->cluster[i] = clusterId;
+            queuedIn[i] = clusterId;
+            for (int j = 0; j < neighborCount; j++) {
+                queuedIn[neighbors[j]] = clusterId;
+            }
 
             for (int j = 0; j < neighborCount; j++) {
-                printf("    in for %d neighborIdx : %d \n", j, neighbors[j]);
+                DBSCAN_LOG("    in for %d neighborIdx : %d \n", j, neighbors[j]);
                 int neighborIdx = neighbors[j];
                 // if (points[neighborIdx].snr > 25) continue;
                 if (result->visited[neighborIdx] == UNVISITED) {
                     result->visited[neighborIdx] = 1;
-                    int nextNeighbors[MAX_POINTS];
-                    int nextNeighborCount = findNeighbors(points, numPoints, neighborIdx, eps, nextNeighbors);
+                    int nextNeighborCount = findNeighbors(points, xs, ys, numPoints, neighborIdx, eps, ctx->dopplerGate, nextNeighbors);
                     if (nextNeighborCount >= minSamples) {
                         for (int k = 0; k < nextNeighborCount; k++) {
+                            if (queuedIn[nextNeighbors[k]] == clusterId) continue;
+                            queuedIn[nextNeighbors[k]] = clusterId;
                             neighbors[neighborCount++] = nextNeighbors[k];
                         }
                     }
@@ -102,6 +681,417 @@ void pointDbscan(GTRACK_measurementPoint *points, int numPoints, float eps, int
             }
         }
     }
+
+    return true;
+}
+
+// Parallel DBSCAN producing the same labels as pointDbscan.
+//
+// Sequential expansion boils down to these rules:
+//  - a core point has snr >= 25 and at least minSamples gated neighbours
+//  - gated cores within eps of each other always share a cluster, so they
+//    form components; a component is started either by its lowest index or
+//    by an earlier non-gated core within eps (those are never queued as
+//    neighbours, so each one always starts its own cluster)
+//  - cluster ids are handed out in order of the starting point's index
+//  - a gated non-core point joins the lowest-id cluster with a core within eps
+// Neighbour counts and component unions run over threads on a spatial grid,
+// the id assignment is a single O(N) pass.
+typedef struct {
+    const GTRACK_measurementPoint *points;
+    int numPoints;
+    float eps;
+    int minSamples;
+    int numThreads;
+    float *x;
+    float *y;
+    unsigned char *gated;
+    unsigned char *core;
+    _Atomic int *parent;
+    _Atomic int *claim;
+    int *clusterId;
+    int *pointCell;
+    int *cellStart;
+    int *cellPoints;
+    int gridW;
+    int gridH;
+    float cellSize;
+    float gridX0;
+    float gridY0;
+    pthread_barrier_t barrier;
+    pthread_mutex_t startLock;          // workers wait here until numThreads is final
+    pthread_cond_t startCond;
+    bool started;
+    bool aborted;
+    DBSCANResult *result;
+} ParallelDbscanJob;
+
+typedef struct {
+    ParallelDbscanJob *job;
+    int threadIdx;
+} ParallelDbscanWorker;
+
+static int ufFind(_Atomic int *parent, int i) {
+    for (;;) {
+        int p = atomic_load(&parent[i]);
+        if (p == i) return i;
+        int gp = atomic_load(&parent[p]);
+        if (p != gp) atomic_compare_exchange_weak(&parent[i], &p, gp);
+        i = p;
+    }
+}
+
+// Roots always link under the smaller index, so a root is its component's minimum.
+static void ufUnion(_Atomic int *parent, int a, int b) {
+    for (;;) {
+        a = ufFind(parent, a);
+        b = ufFind(parent, b);
+        if (a == b) return;
+        if (a < b) {
+            int temp = a;
+            a = b;
+            b = temp;
+        }
+        int expected = a;
+        if (atomic_compare_exchange_strong(&parent[a], &expected, b)) return;
+    }
+}
+
+static void atomicMin(_Atomic int *target, int value) {
+    int current = atomic_load(target);
+    while (value < current && !atomic_compare_exchange_weak(target, &current, value)) {
+    }
+}
+
+// Visits every j != i within eps of point i by scanning the surrounding 3x3 cells.
+#define FOR_EACH_GRID_NEIGHBOR(job, i, j, body)                                           \
+    do {                                                                                  \
+        int cx_ = (job)->pointCell[i] % (job)->gridW;                                     \
+        int cy_ = (job)->pointCell[i] / (job)->gridW;                                     \
+        for (int gy_ = cy_ - 1; gy_ <= cy_ + 1; gy_++) {                                  \
+            if (gy_ < 0 || gy_ >= (job)->gridH) continue;                                 \
+            for (int gx_ = cx_ - 1; gx_ <= cx_ + 1; gx_++) {                              \
+                if (gx_ < 0 || gx_ >= (job)->gridW) continue;                             \
+                int cell_ = gy_ * (job)->gridW + gx_;                                     \
+                for (int k_ = (job)->cellStart[cell_]; k_ < (job)->cellStart[cell_ + 1]; k_++) { \
+                    int j = (job)->cellPoints[k_];                                        \
+                    if (j == (i)) continue;                                               \
+                    if (distanceXY((job)->x[i], (job)->y[i], (job)->x[j], (job)->y[j]) > (job)->eps) continue; \
+                    body                                                                  \
+                }                                                                         \
+            }                                                                             \
+        }                                                                                 \
+    } while (0)
+
+static void *parallelDbscanWorker(void *arg) {
+    ParallelDbscanWorker *worker = (ParallelDbscanWorker*) arg;
+    ParallelDbscanJob *job = worker->job;
+    int n = job->numPoints;
+
+    pthread_mutex_lock(&job->startLock);
+    while (!job->started) pthread_cond_wait(&job->startCond, &job->startLock);
+    pthread_mutex_unlock(&job->startLock);
+    if (job->aborted) return NULL;
+
+    // Each thread owns a contiguous run of the cell-sorted points.
+    int begin = (int)((long long)n * worker->threadIdx / job->numThreads);
+    int end = (int)((long long)n * (worker->threadIdx + 1) / job->numThreads);
+
+    for (int k = begin; k < end; k++) {
+        int i = job->cellPoints[k];
+        int count = 0;
+        FOR_EACH_GRID_NEIGHBOR(job, i, j, {
+            if (job->gated[j]) count++;
+        });
+        job->core[i] = job->points[i].snr >= NEIGHBOR_MIN_SNR && count >= job->minSamples;
+    }
+    pthread_barrier_wait(&job->barrier);
+
+    for (int k = begin; k < end; k++) {
+        int i = job->cellPoints[k];
+        if (!job->core[i] || !job->gated[i]) continue;
+        FOR_EACH_GRID_NEIGHBOR(job, i, j, {
+            if (j > i && job->core[j] && job->gated[j]) ufUnion(job->parent, i, j);
+        });
+    }
+    pthread_barrier_wait(&job->barrier);
+
+    for (int k = begin; k < end; k++) {
+        int i = job->cellPoints[k];
+        if (!job->core[i] || job->gated[i]) continue;
+        FOR_EACH_GRID_NEIGHBOR(job, i, j, {
+            if (job->core[j] && job->gated[j]) atomicMin(&job->claim[ufFind(job->parent, j)], i);
+        });
+    }
+    pthread_barrier_wait(&job->barrier);
+
+    if (worker->threadIdx == 0) {
+        int nextId = 0;
+        for (int i = 0; i < n; i++) {
+            job->clusterId[i] = NOISE;
+            if (!job->core[i]) continue;
+            if (!job->gated[i] || (ufFind(job->parent, i) == i && atomic_load(&job->claim[i]) == i)) {
+                job->clusterId[i] = ++nextId;
+            }
+        }
+        for (int i = 0; i < n; i++) {
+            if (job->core[i] && job->gated[i]) {
+                job->clusterId[i] = job->clusterId[atomic_load(&job->claim[ufFind(job->parent, i)])];
+            }
+        }
+    }
+    pthread_barrier_wait(&job->barrier);
+
+    for (int k = begin; k < end; k++) {
+        int i = job->cellPoints[k];
+        int label = job->clusterId[i];
+        if (!job->core[i] && job->gated[i]) {
+            FOR_EACH_GRID_NEIGHBOR(job, i, j, {
+                if (job->core[j] && (label == NOISE || job->clusterId[j] < label)) label = job->clusterId[j];
+            });
+        }
+        job->result->cluster[i] = label;
+        job->result->visited[i] = 1;
+    }
+    return NULL;
+}
+
+// Worker threads are created and joined on every call with the default stack
+// size; they are not part of the arena budget. numThreads = 1 spawns nothing.
+// If fewer threads can be started than requested, the frame runs on those.
+// Returns false (with every point marked NOISE) like pointDbscan.
+bool pointDbscanParallel(TreeFilterContext *ctx, GTRACK_measurementPoint *points, int numPoints, float eps, int minSamples, int numThreads, DBSCANResult *result) {
+    if (numPoints > ctx->maxPoints) {
+        printf("pointDbscanParallel: %d points exceeds context limit %d\n", numPoints, ctx->maxPoints);
+        markAllNoise(result, numPoints);
+        return false;
+    }
+    if (numThreads < 1) numThreads = 1;
+    if (numThreads > DBSCAN_MAX_THREADS) numThreads = DBSCAN_MAX_THREADS;
+    if (numThreads > numPoints) numThreads = numPoints > 0 ? numPoints : 1;
+
+    ParallelDbscanJob job;
+    job.points = points;
+    job.numPoints = numPoints;
+    job.eps = eps;
+    job.minSamples = minSamples;
+    job.numThreads = numThreads;
+    job.result = result;
+    job.x = (float*) arenaAlloc(&ctx->arena, numPoints * sizeof(float));
+    job.y = (float*) arenaAlloc(&ctx->arena, numPoints * sizeof(float));
+    job.gated = (unsigned char*) arenaAlloc(&ctx->arena, numPoints);
+    job.core = (unsigned char*) arenaAlloc(&ctx->arena, numPoints);
+    job.parent = (_Atomic int*) arenaAlloc(&ctx->arena, numPoints * sizeof(int));
+    job.claim = (_Atomic int*) arenaAlloc(&ctx->arena, numPoints * sizeof(int));
+    job.clusterId = (int*) arenaAlloc(&ctx->arena, numPoints * sizeof(int));
+    job.pointCell = (int*) arenaAlloc(&ctx->arena, numPoints * sizeof(int));
+    job.cellPoints = (int*) arenaAlloc(&ctx->arena, numPoints * sizeof(int));
+    if (job.x == NULL || job.y == NULL || job.gated == NULL || job.core == NULL ||
+        job.parent == NULL || job.claim == NULL ||
+        job.clusterId == NULL || job.pointCell == NULL || job.cellPoints == NULL) {
+        printf("pointDbscanParallel: scratch arena exhausted\n");
+        markAllNoise(result, numPoints);
+        return false;
+    }
+
+    float xmin = FLT_MAX, ymin = FLT_MAX, xmax = -FLT_MAX, ymax = -FLT_MAX;
+    for (int i = 0; i < numPoints; i++) {
+        toCartesian(&points[i], &job.x[i], &job.y[i]);
+        job.gated[i] = passesNeighborGate(&points[i], ctx->dopplerGate);
+        atomic_init(&job.parent[i], i);
+        atomic_init(&job.claim[i], i);
+        if (job.x[i] < xmin) xmin = job.x[i];
+        if (job.y[i] < ymin) ymin = job.y[i];
+        if (job.x[i] > xmax) xmax = job.x[i];
+        if (job.y[i] > ymax) ymax = job.y[i];
+    }
+
+    // Cells are at least eps wide, grown until the grid fits in 4 * maxPoints cells.
+    int maxCells = 4 * ctx->maxPoints + 1;
+    job.cellSize = eps > 0 ? eps : 1.0f;
+    job.gridX0 = numPoints > 0 ? xmin : 0.0f;
+    job.gridY0 = numPoints > 0 ? ymin : 0.0f;
+    for (;;) {
+        float w = numPoints > 0 ? (xmax - xmin) / job.cellSize : 0.0f;
+        float h = numPoints > 0 ? (ymax - ymin) / job.cellSize : 0.0f;
+        if (w < maxCells && h < maxCells && ((long long)w + 1) * ((long long)h + 1) <= maxCells) {
+            job.gridW = (int)w + 1;
+            job.gridH = (int)h + 1;
+            break;
+        }
+        job.cellSize *= 2.0f;
+    }
+    int numCells = job.gridW * job.gridH;
+    job.cellStart = (int*) arenaAlloc(&ctx->arena, (numCells + 1) * sizeof(int));
+    if (job.cellStart == NULL) {
+        printf("pointDbscanParallel: scratch arena exhausted\n");
+        markAllNoise(result, numPoints);
+        return false;
+    }
+
+    memset(job.cellStart, 0, (numCells + 1) * sizeof(int));
+    for (int i = 0; i < numPoints; i++) {
+        int cx = (int)((job.x[i] - job.gridX0) / job.cellSize);
+        int cy = (int)((job.y[i] - job.gridY0) / job.cellSize);
+        if (cx >= job.gridW) cx = job.gridW - 1;
+        if (cy >= job.gridH) cy = job.gridH - 1;
+        job.pointCell[i] = cy * job.gridW + cx;
+        job.cellStart[job.pointCell[i] + 1]++;
+    }
+    for (int c = 0; c < numCells; c++) {
+        job.cellStart[c + 1] += job.cellStart[c];
+    }
+    // Fill back to front so each cell keeps ascending point order; this leaves
+    // cellStart[c + 1] at the start of cell c, so shift it down afterwards.
+    for (int i = numPoints - 1; i >= 0; i--) {
+        job.cellPoints[--job.cellStart[job.pointCell[i] + 1]] = i;
+    }
+    for (int c = 0; c < numCells; c++) {
+        job.cellStart[c] = job.cellStart[c + 1];
+    }
+    job.cellStart[numCells] = numPoints;
+
+    pthread_t threads[DBSCAN_MAX_THREADS];
+    ParallelDbscanWorker workers[DBSCAN_MAX_THREADS];
+    for (int t = 0; t < numThreads; t++) {
+        workers[t].job = &job;
+        workers[t].threadIdx = t;
+    }
+    pthread_mutex_init(&job.startLock, NULL);
+    pthread_cond_init(&job.startCond, NULL);
+    job.started = false;
+    job.aborted = false;
+    int startedThreads = 1;
+    while (startedThreads < numThreads &&
+           pthread_create(&threads[startedThreads], NULL, parallelDbscanWorker, &workers[startedThreads]) == 0) {
+        startedThreads++;
+    }
+    job.numThreads = startedThreads;
+    bool ok = pthread_barrier_init(&job.barrier, NULL, startedThreads) == 0;
+
+    pthread_mutex_lock(&job.startLock);
+    job.aborted = !ok;
+    job.started = true;
+    pthread_cond_broadcast(&job.startCond);
+    pthread_mutex_unlock(&job.startLock);
+
+    if (ok) parallelDbscanWorker(&workers[0]);
+    for (int t = 1; t < startedThreads; t++) {
+        pthread_join(threads[t], NULL);
+    }
+    if (ok) pthread_barrier_destroy(&job.barrier);
+    pthread_cond_destroy(&job.startCond);
+    pthread_mutex_destroy(&job.startLock);
+    if (!ok) {
+        printf("pointDbscanParallel: barrier setup failed\n");
+        markAllNoise(result, numPoints);
+    }
+    return ok;
+}
+
+// Adaptive per-frame parameters. One O(N) pass over the foliage returns
+// (|doppler| below ADAPT_MOVER_DOPPLER) estimates how much the trees sway and
+// how densely they are sampled, and the matching eps / minSamples / doppler
+// gate are read from adaptParamTable.
+//
+// The table is derived from the Beaufort2 and Beaufort6 tree recordings
+// (20250304_sim/1.Only tree scenario), one run each:
+//  - wind: per-frame mean |doppler| of foliage is 0.156 at the Beaufort2 p90
+//    and 0.182 at the Beaufort6 p90; calm/breezy splits just above one
+//    doppler bin and breezy/windy at the Beaufort6 p90. Breezy is interpolated,
+//    there is no recording between the two.
+//  - gate: smallest gate letting >= 99.5% of the class's foliage through
+//    (0.2 passes 99.5% of Beaufort2, 0.4 passes 99.5% and 0.6 99.9% of
+//    Beaufort6).
+//  - density: foliage points per m^2 of their bounding box, split at the
+//    pooled terciles.
+//  - eps: p75 of the distance to the minSamples-th nearest foliage neighbour
+//    within each density class, so three quarters of the points can be core.
+// The recordings hold almost no returns at NEIGHBOR_MIN_SNR or above, so all
+// foliage returns are used regardless of SNR; retune once SNR >= 25 scenes
+// are recorded.
+#define ADAPT_MOVER_DOPPLER 1.5f        // |doppler| at or above this is a mover, not foliage
+#define ADAPT_MIN_PASS_FRACTION 0.95f   // widen the gate until this much foliage passes it
+#define ADAPT_MIN_AREA 1.0f             // m^2, floor for the bounding box of a tight frame
+#define ADAPT_WIND_CLASSES 3
+#define ADAPT_DENSITY_CLASSES 3
+
+typedef struct {
+    float eps;
+    int minSamples;
+    float dopplerGate;
+} FilterParams;
+
+typedef struct {
+    int foliageCount;
+    float density;                      // foliage points per m^2 of their bounding box
+    float dopplerSpread;                // mean |doppler| of foliage points
+    float passFraction;                 // share of those inside the chosen doppler gate
+    int windClass;
+    int densityClass;
+} FilterSceneStats;
+
+static const float adaptWindSpreadLimits[ADAPT_WIND_CLASSES - 1] = {0.16f, 0.18f};
+static const float adaptDensityLimits[ADAPT_DENSITY_CLASSES - 1] = {0.12f, 0.49f};
+
+// [wind class: calm, breezy, windy][density class: sparse, normal, dense]
+static const FilterParams adaptParamTable[ADAPT_WIND_CLASSES][ADAPT_DENSITY_CLASSES] = {
+    {{1.8f, 2, 0.2f}, {2.3f, 3, 0.2f}, {1.3f, 4, 0.2f}},
+    {{1.8f, 2, 0.4f}, {2.3f, 3, 0.4f}, {1.3f, 4, 0.4f}},
+    {{1.8f, 2, 0.6f}, {2.3f, 3, 0.6f}, {1.3f, 4, 0.6f}},
+};
+
+FilterParams selectAdaptiveParams(const GTRACK_measurementPoint *points, int numPoints, FilterSceneStats *stats) {
+    int foliageCount = 0;
+    float dopplerSum = 0.0f;
+    float xmin = 0.0f, xmax = 0.0f, ymin = 0.0f, ymax = 0.0f;
+    for (int i = 0; i < numPoints; i++) {
+        float doppler = fabsf(points[i].vector.doppler);
+        if (doppler >= ADAPT_MOVER_DOPPLER) continue;
+        float x, y;
+        toCartesian(&points[i], &x, &y);
+        if (foliageCount == 0) {
+            xmin = xmax = x;
+            ymin = ymax = y;
+        } else {
+            xmin = fminf(xmin, x);
+            xmax = fmaxf(xmax, x);
+            ymin = fminf(ymin, y);
+            ymax = fmaxf(ymax, y);
+        }
+        foliageCount++;
+        dopplerSum += doppler;
+    }
+    float spread = foliageCount > 0 ? dopplerSum / foliageCount : 0.0f;
+    float density = foliageCount / fmaxf(ADAPT_MIN_AREA, (xmax - xmin) * (ymax - ymin));
+
+    int densityClass = 0;
+    while (densityClass < ADAPT_DENSITY_CLASSES - 1 && density >= adaptDensityLimits[densityClass]) densityClass++;
+    int windClass = 0;
+    while (windClass < ADAPT_WIND_CLASSES - 1 && spread >= adaptWindSpreadLimits[windClass]) windClass++;
+
+    int insideGate[ADAPT_WIND_CLASSES] = {0};
+    for (int i = 0; i < numPoints; i++) {
+        float doppler = fabsf(points[i].vector.doppler);
+        if (doppler >= ADAPT_MOVER_DOPPLER) continue;
+        for (int w = 0; w < ADAPT_WIND_CLASSES; w++) {
+            if (doppler < adaptParamTable[w][densityClass].dopplerGate) insideGate[w]++;
+        }
+    }
+    while (windClass < ADAPT_WIND_CLASSES - 1 && foliageCount > 0 &&
+           insideGate[windClass] < ADAPT_MIN_PASS_FRACTION * foliageCount) {
+        windClass++;
+    }
+
+    if (stats != NULL) {
+        stats->foliageCount = foliageCount;
+        stats->density = density;
+        stats->dopplerSpread = spread;
+        stats->passFraction = foliageCount > 0 ? (float) insideGate[windClass] / foliageCount : 1.0f;
+        stats->windClass = windClass;
+        stats->densityClass = densityClass;
+    }
+    return adaptParamTable[windClass][densityClass];
 }
 
 bool checkCondition(GTRACK_measurementPoint *cluster, int clusterSize) {
@@ -113,10 +1103,18 @@ bool checkCondition(GTRACK_measurementPoint *cluster, int clusterSize) {
     return countPoints > (0.5 * clusterSize);
 }
 
-void getLargestCluster(GTRACK_measurementPoint *points, int numPoints, DBSCANResult *result, int *clusterSize, float *xmin, float *ymin, float *xmax, float *ymax) {
-    int clusterCounts[MAX_POINTS] = {0};
-    int sortedClusters[MAX_POINTS];
+void getLargestCluster(TreeFilterContext *ctx, GTRACK_measurementPoint *points, int numPoints, DBSCANResult *result, int *clusterSize, float *xmin, float *ymin, float *xmax, float *ymax) {
+    int *clusterCounts = (int*) arenaAlloc(&ctx->arena, (numPoints + 1) * sizeof(int));
+    int *sortedClusters = (int*) arenaAlloc(&ctx->arena, numPoints * sizeof(int));
+    GTRACK_measurementPoint *candidateCluster = (GTRACK_measurementPoint*) arenaAlloc(&ctx->arena, numPoints * sizeof(GTRACK_measurementPoint));
     int uniqueClusters = 0;
+
+    if (clusterCounts == NULL || sortedClusters == NULL || candidateCluster == NULL) {
+        printf("getLargestCluster: scratch arena exhausted\n");
+        *clusterSize = 0;
+        return;
+    }
+    memset(clusterCounts, 0, (numPoints + 1) * sizeof(int));
     
     for (int i = 0; i < numPoints; i++) {
         if (result->cluster[i] >= 0) {
@@ -148,7 +1146,6 @@ void getLargestCluster(GTRACK_measurementPoint *points, int numPoints, DBSCANRes
     for (int k = 0; k < uniqueClusters; k++) {
         int clusterId = sortedClusters[k];
         int currentSize = clusterCounts[clusterId];
-        GTRACK_measurementPoint *candidateCluster = (GTRACK_measurementPoint*) malloc(currentSize * sizeof(GTRACK_measurementPoint));
         int index = 0;
         
         for (int i = 0; i < numPoints; i++) {
@@ -159,10 +1156,8 @@ void getLargestCluster(GTRACK_measurementPoint *points, int numPoints, DBSCANRes
 
         if (checkCondition(candidateCluster, currentSize)) {
             targetCluster = clusterId;
-            free(candidateCluster);
             break;
         }
-        free(candidateCluster);
     }
     
     if (targetCluster == -1) {
@@ -171,8 +1166,6 @@ void getLargestCluster(GTRACK_measurementPoint *points, int numPoints, DBSCANRes
     }
 
     int finalSize = clusterCounts[targetCluster];
-    GTRACK_measurementPoint *finalCluster = (GTRACK_measurementPoint*) malloc(finalSize * sizeof(GTRACK_measurementPoint));
-    int index = 0;
     *xmin = 99.0f;
     *ymin = 99.0f;
     *xmax = -99.0f;
@@ -180,18 +1173,14 @@ void getLargestCluster(GTRACK_measurementPoint *points, int numPoints, DBSCANRes
     
     for (int i = 0; i < numPoints; i++) {
         if (result->cluster[i] == targetCluster) {
-            finalCluster[index++] = points[i];
-            float azimuth_rad = points[i].vector.azimuth * (M_PI / 180.0f);
-            float x = points[i].vector.range * sinf(azimuth_rad);
-            float y = points[i].vector.range * cosf(azimuth_rad);
-            int x_scaled = (int)(x * 100);
-            int y_scaled = (int)(y * 100);
+            float x, y;
+            toCartesian(&points[i], &x, &y);
 
             if (x < *xmin) *xmin = x;
             if (y < *ymin) *ymin = y;
             if (x > *xmax) *xmax = x;
             if (y > *ymax) *ymax = y;
-            printf("i: %d, x: %.d,y: %.d\n", i, x_scaled, y_scaled);
+            DBSCAN_LOG("i: %d, x: %.d,y: %.d\n", i, (int)(x * 100), (int)(y * 100));
         }
     }
 
@@ -216,7 +1205,618 @@ void computePairwiseDistanceMatrix(GTRACK_measurementPoint *points, int numPoint
     }
 }
 
-int main() {    
+// Fixed-layout per-frame filter output. Every field is naturally aligned and
+// the struct has no implicit padding, so a consumer can mmap a ring or record
+// file and use the records in place instead of parsing the printf trace.
+#define FILTER_RECORD_MAGIC 0x52465254u   // "TRFR" in little-endian byte order
+#define FILTER_RECORD_VERSION 1
+#define FILTER_MAX_BOXES 4
+#define FILTER_LABEL_SLOTS ((MAX_POINTS + 3) & ~3)
+
+enum {
+    FILTER_STAGE_DBSCAN = 0,
+    FILTER_STAGE_CLUSTER_SELECT = 1,
+    FILTER_STAGE_ADAPT = 2,
+    FILTER_NUM_STAGES = 4               // unused slots stay 0
+};
+
+typedef struct {
+    float xmin;
+    float ymin;
+    float xmax;
+    float ymax;
+    int32_t numPoints;
+    int32_t reserved;
+} FilterBox;
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t labelSlots;                // FILTER_LABEL_SLOTS of the writer
+    uint32_t recordBytes;               // sizeof(FilterFrameRecord) of the writer
+    uint32_t frameNumber;
+    uint16_t numPoints;
+    uint16_t numBoxes;
+    uint32_t reserved;
+    uint32_t stageNs[FILTER_NUM_STAGES];
+    FilterBox boxes[FILTER_MAX_BOXES];
+    int16_t labels[FILTER_LABEL_SLOTS]; // DBSCANResult.cluster per point
+} FilterFrameRecord;
+
+_Static_assert(sizeof(FilterBox) == 24, "FilterBox layout changed");
+_Static_assert(sizeof(FilterFrameRecord) == 136 + 2 * FILTER_LABEL_SLOTS, "FilterFrameRecord has padding");
+
+static uint32_t filterNowNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000000000ull + ts.tv_nsec);
+}
+
+// Frames larger than DBSCANResult (and so the labels array) are truncated
+// to their first MAX_POINTS labels.
+void fillFilterRecord(FilterFrameRecord *record, uint32_t frameNumber, int numPoints, const DBSCANResult *result) {
+    if (numPoints > MAX_POINTS) numPoints = MAX_POINTS;
+    if (numPoints < 0) numPoints = 0;
+    memset(record, 0, sizeof(*record));
+    record->magic = FILTER_RECORD_MAGIC;
+    record->version = FILTER_RECORD_VERSION;
+    record->labelSlots = FILTER_LABEL_SLOTS;
+    record->recordBytes = sizeof(FilterFrameRecord);
+    record->frameNumber = frameNumber;
+    record->numPoints = (uint16_t) numPoints;
+    for (int i = 0; i < numPoints; i++) {
+        record->labels[i] = (int16_t) result->cluster[i];
+    }
+}
+
+void addFilterBox(FilterFrameRecord *record, int numPoints, float xmin, float ymin, float xmax, float ymax) {
+    if (record->numBoxes >= FILTER_MAX_BOXES) return;
+    FilterBox *box = &record->boxes[record->numBoxes++];
+    box->xmin = xmin;
+    box->ymin = ymin;
+    box->xmax = xmax;
+    box->ymax = ymax;
+    box->numPoints = numPoints;
+}
+
+// Append-only record file: a plain sequence of FilterFrameRecord, so record n
+// sits at offset n * recordBytes of the mmap'ed file.
+bool appendFilterRecord(FILE *file, const FilterFrameRecord *record) {
+    if (fwrite(record, sizeof(*record), 1, file) != 1) return false;
+    return fflush(file) == 0;
+}
+
+// Single-producer ring of records, laid over any shared memory region.
+// Slot n % slotCount holds record n. Its seq is odd while the writer is inside
+// and 2 * (n + 1) once record n is complete; readers check seq before and after
+// using the record in place to detect that it was overwritten.
+typedef struct {
+    uint32_t magic;
+    uint32_t slotCount;
+    uint32_t slotBytes;
+    uint32_t reserved;
+    _Atomic uint64_t writeSeq;          // number of records published
+    uint64_t reserved2;
+} FilterRingHeader;
+
+typedef struct {
+    _Atomic uint32_t seq;
+    uint32_t reserved;
+    FilterFrameRecord record;
+} FilterRingSlot;
+
+static FilterRingSlot *filterRingSlot(const FilterRingHeader *ring, uint64_t n) {
+    return (FilterRingSlot*)((unsigned char*)(ring + 1) + (n % ring->slotCount) * ring->slotBytes);
+}
+
+size_t filterRingBytes(uint32_t slotCount) {
+    return sizeof(FilterRingHeader) + (size_t)slotCount * sizeof(FilterRingSlot);
+}
+
+FilterRingHeader *filterRingInit(void *memory, size_t bytes) {
+    if (bytes < filterRingBytes(1)) return NULL;
+    FilterRingHeader *ring = (FilterRingHeader*) memory;
+    memset(memory, 0, bytes);
+    ring->slotCount = (uint32_t)((bytes - sizeof(FilterRingHeader)) / sizeof(FilterRingSlot));
+    ring->slotBytes = sizeof(FilterRingSlot);
+    atomic_init(&ring->writeSeq, 0);
+    ring->magic = FILTER_RECORD_MAGIC;
+    return ring;
+}
+
+// Hands out the next slot's record so the frame can be filled in place;
+// filterRingCommit() publishes it.
+FilterFrameRecord *filterRingClaim(FilterRingHeader *ring) {
+    uint64_t n = atomic_load_explicit(&ring->writeSeq, memory_order_relaxed);
+    FilterRingSlot *slot = filterRingSlot(ring, n);
+    atomic_store_explicit(&slot->seq, (uint32_t)(2 * n + 1), memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    return &slot->record;
+}
+
+void filterRingCommit(FilterRingHeader *ring) {
+    uint64_t n = atomic_load_explicit(&ring->writeSeq, memory_order_relaxed);
+    FilterRingSlot *slot = filterRingSlot(ring, n);
+    atomic_store_explicit(&slot->seq, (uint32_t)(2 * (n + 1)), memory_order_release);
+    atomic_store_explicit(&ring->writeSeq, n + 1, memory_order_release);
+}
+
+// Reader side: returns record n in place, or NULL if it is not published yet
+// or already overwritten. Pass *seq to filterRingStillValid() after use.
+const FilterFrameRecord *filterRingPeek(const FilterRingHeader *ring, uint64_t n, uint32_t *seq) {
+    if (n >= atomic_load_explicit(&((FilterRingHeader*)ring)->writeSeq, memory_order_acquire)) return NULL;
+    FilterRingSlot *slot = filterRingSlot(ring, n);
+    *seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+    if (*seq != (uint32_t)(2 * (n + 1))) return NULL;
+    return &slot->record;
+}
+
+bool filterRingStillValid(const FilterRingHeader *ring, uint64_t n, uint32_t seq) {
+    atomic_thread_fence(memory_order_acquire);
+    return atomic_load_explicit(&filterRingSlot(ring, n)->seq, memory_order_relaxed) == seq;
+}
+
+#ifndef _WIN32
+// Creates a POSIX shared memory ring, e.g. name "/treefilter", or reopens an
+// existing one. An existing ring with the same layout and slotCount keeps its
+// records and writeSeq, so a restarted producer continues the sequence and
+// readers' seqlock checks stay valid. A same-sized object with another layout
+// is initialised afresh. An object of another size is never resized in place,
+// since readers still mapping the old size would fault: it is unlinked and
+// created anew, the old mappings stay backed, and readers must re-attach.
+FilterRingHeader *filterRingOpenShm(const char *name, uint32_t slotCount) {
+    size_t bytes = filterRingBytes(slotCount);
+    bool created = true;
+    int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0 && errno == EEXIST) {
+        created = false;
+        fd = shm_open(name, O_RDWR, 0644);
+        struct stat st;
+        if (fd >= 0 && (fstat(fd, &st) != 0 || (size_t) st.st_size != bytes)) {
+            close(fd);
+            if (shm_unlink(name) != 0 && errno != ENOENT) return NULL;
+            created = true;
+            fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+        }
+    }
+    if (fd < 0) return NULL;
+    if (created && ftruncate(fd, bytes) != 0) {
+        close(fd);
+        return NULL;
+    }
+    void *memory = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (memory == MAP_FAILED) return NULL;
+
+    FilterRingHeader *ring = (FilterRingHeader*) memory;
+    if (created || ring->magic != FILTER_RECORD_MAGIC ||
+        ring->slotBytes != sizeof(FilterRingSlot) || ring->slotCount != slotCount) {
+        return filterRingInit(memory, bytes);
+    }
+    return ring;
+}
+
+// Read-only attach for consumers; never writes to the ring. Returns NULL if
+// the ring does not exist or was written with a different record layout.
+// Release with munmap(ring, filterRingBytes(ring->slotCount)).
+const FilterRingHeader *filterRingAttachShm(const char *name) {
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) return NULL;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t) st.st_size < filterRingBytes(1)) {
+        close(fd);
+        return NULL;
+    }
+    void *memory = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (memory == MAP_FAILED) return NULL;
+
+    const FilterRingHeader *ring = (const FilterRingHeader*) memory;
+    if (ring->magic != FILTER_RECORD_MAGIC || ring->slotBytes != sizeof(FilterRingSlot) ||
+        filterRingBytes(ring->slotCount) > (size_t) st.st_size) {
+        munmap(memory, st.st_size);
+        return NULL;
+    }
+    return ring;
+}
+#endif
+
+#ifdef DBSCAN_BENCH
+static const GTRACK_measurementPoint benchFrame317[] = {
+    {{0.640625, -68.318503, 0.0, 0.0}, 12},
+    {{0.625, -61.100577, 0.0, 0.0}, 12},
+    {{4.859375, -21.597823, 0.0, 0.0}, 14},
+    {{4.828125, -19.023989, 0.0, 0.0}, 14},
+    {{17.375, 10.127477, 0.0, 0.0}, 8},
+    {{17.15625, 13.876322, 0.0, 0.0}, 9},
+    {{17.609375, 15.778721, 0.0, 0.0}, 8},
+    {{17.578125, 19.639471, 0.0, 0.0}, 8},
+    {{5.875, 24.507374, 0.0, 0.0}, 24},
+    {{5.875, 27.360973, 0.0, 0.0}, 22},
+    {{5.875, 27.081208, 0.0, 0.0}, 23},
+    {{6.265625, 33.347934, 0.0, 0.0}, 13},
+    {{22.375, 32.732452, 0.0, 0.0}, 8},
+    {{5.71875, 34.411039, 0.0, 0.0}, 13},
+    {{6.28125, 37.040826, 0.0, 0.0}, 12},
+    {{22.40625, 35.977721, 0.0, 0.0}, 8}
+};
+
+static const GTRACK_measurementPoint benchFrame320[] = {
+    {{0.640625, -63.78631592, 0.0, 0.0}, 8},
+    {{0.609375, -49.9099960, 0.0, 0.0}, 9},
+    {{0.609375, -46.72068024, 0.0, 0.0}, 9},
+    {{0.59375, -40.901577, 0.0, 0.0}, 9},
+    {{4.796875, -5.763149738, 0.0, 0.0}, 22},
+    {{4.90625, -5.595291138, 0.0, 0.0}, 25},
+    {{4.90625, -5.595291138, 0.0, 0.0}, 25},
+    {{5.15625, -4.196468353, 0.0, 0.0}, 20},
+    {{4.34375, -1.902398944, 0.0, 0.0}, 12},
+    {{4.234375, 0, 0.0, 0.0}, 12},
+    {{4.234375, 1.846446037, 0.0, 0.0}, 12},
+    {{4.234375, 2.741692543, 0.0, 0.0}, 12},
+    {{6.28125, 18.6323185, 0.0, 0.0}, 11},
+    {{6.265625, 18.6323185, 0.0, 0.0}, 11},
+    {{6.203125, 24.50737381, 0.0, 0.0}, 10},
+    {{9.453125, 31.66934776, 0.0, 0.0}, 9},
+    {{9.453125, 32.73245239, 0.0, 0.0}, 9},
+    {{9.09375, 35.97772217, 0.0, 0.0}, 9},
+    {{6.125, 36.53725052, 0.0, 0.0}, 16},
+    {{9.09375, 35.97772217, 0.0, 0.0}, 9},
+    {{9.46875, 39.72656631, 0.0, 0.0}, 9},
+    {{9.71875, 46.32901001, 0.0, 0.0}, 8},
+    {{0.59375, 56.45648575, 0.0, 0.0}, 8},
+    {{6.09375, 56.45648575, 0.0, 0.0}, 14}
+};
+
+static const GTRACK_measurementPoint benchFrame326[] = {
+    {{0.625, -59.47794342, 0.0, 0.0}, 13},
+    {{0.625, -59.47794342, 0.0, 0.0}, 13},
+    {{5.125, -22.43711662, 0.0, 0.0}, 22},
+    {{4.859375, -14.82752132, 0.0, 0.0}, 17},
+    {{4.84375, -14.82752132, 0.0, 0.0}, 17},
+    {{5.6875, 11.52629948, 0.0, 0.0}, 27},
+    {{5.875, 11.97392273, 0.0, 0.0}, 29},
+    {{5.875, 11.97392273, 0.0, 0.0}, 28},
+    {{6.640625, 13.87632179, 0.0, 0.0}, 11},
+    {{6.640625, 13.87632179, 0.0, 0.0}, 10},
+    {{6.046875, 16.72991943, 0.0, 0.0}, 28},
+    {{6.265625, 18.91208267, 0.0, 0.0}, 22},
+    {{6.828125, 21.87758827, 0.0, 0.0}, 10},
+    {{7.890625, 22.54902267, 0.0, 0.0}, 7},
+    {{6.84375, 26.85739708, 0.0, 0.0}, 10}
+};
+
+static const GTRACK_measurementPoint benchFrameRun2101[] = {
+    {{8.203125, -35.47, 0.0, 0.15}, 11},
+    {{6.9375, -5.595, 0.0, 0.15}, 18},
+    {{4.859375, -3.9726, 0.0, 0.15}, 22},
+    {{4.875, -4.08456, 0.0, 0.15}, 25},
+    {{4.4375, -1.902, 0.0, 0.15}, 8},
+    {{4.765625, 0.223, 0.0, 0.15}, 25},
+    {{6.6875, -0.2797, 0.0, 0.15}, 18},
+    {{6.65625, 3.189, 0.0, 0.15}, 18},
+    {{5.453125, 10.127, 0.0, 0.15}, 20},
+    {{5.46875, 10.127, 0.0, 0.15}, 20},
+    {{6.359375, 11.97, 0.0, 0.15}, 25},
+    {{6.171875, 13.204, 0.0, 0.15}, 24},
+    {{6.34375, 11.973, 0.0, 0.15}, 25},
+    {{6.32125, 16.7299, 0.0, 0.15}, 24},
+    {{8.890625, 31.669, 0.0, 0.15}, 13},
+    {{9.078125, 33.795, 0.0, 0.15}, 8},
+    {{8.890625, 34.858, 0.0, 0.15}, 13},
+    {{9.078125, 33.795, 0.0, 0.15}, 8},
+    {{0.59375, 52.539, 0.0, 0.15}, 10},
+    {{0.609375, 61.772, 0.0, 0.15}, 10},
+    {{0.609375, 61.772, 0.0, 0.15}, 10}
+};
+
+static const GTRACK_measurementPoint benchFrameRun2Frame113[] = {
+    {{0.640625,-69.32565308,0.0, 0.15625}, 11},
+    {{0.640625,-63.78631592,0.0, 0.15625}, 11},
+    {{0.625,-55.44933319,0.0, 0.15625}, 11},
+    {{4.515625,-14.82752132,0.0, 0.15625}, 11},
+    {{5.078125,-16.67396736,0.0, 0.15625}, 28},
+    {{4.515625,-14.82752132,0.0, 0.15625}, 11},
+    {{4.875,-12.2536869,0.0, 0.15625}, 26},
+    {{4.953125,-12.47749901,0.0, 0.15625}, 29},
+    {{5.34375,0.895246565,0.0, -0.15625}, 27},
+    {{5.390625,3.636939049,0.0, -0.15625}, 26},
+    {{5.765625,6.71434927,0.0, -0.15625}, 25},
+    {{6.125,8.281030655,0.0, -0.15625}, 19},
+    {{6.140625,10.79891109,0.0, -0.15625}, 19},
+    {{7.203125,23.83593941,0.0, -0.15625}, 13},
+    {{7.25,26.52167892,0.0, -0.15625}, 12},
+    {{8.53125,33.23602676,0.0, -0.15625}, 13},
+    {{9.125,33.79555893,0.0, -0.15625}, 18},
+    {{1.765625,38.21583557,0.0, 9.25} ,8},
+    {{8.546875,38.21583557,0.0, -0.15625}, 12},
+    {{9.125,38.21583557,0.0, -0.15625}, 18},
+    {{9.3125,37.82416534,0.0, -0.15625}, 18},
+    {{8.5625,38.21583557,0.0, -0.15625}, 12},
+    {{9.125,38.21583557,0.0, -0.15625}, 18},
+    {{9.71875,39.33489609,0.0, -0.15625}, 11},
+    {{1.78125,42.85992813,0.0, 9.25} ,8},
+    {{9.3125,41.29324722,0.0, -0.15625}, 18},
+    {{1.78125,42.85992813,0.0, 9.25} ,8},
+    {{9.96875,45.48971558,0.0, -0.15625}, 10}
+};
+
+static const GTRACK_measurementPoint benchFrameRun2Frame113Sim[] = {
+    {{0.640625,-69.32565308,0.0, 0.15625}, 11},
+    {{0.640625,-63.78631592,0.0, 0.15625}, 11},
+    {{0.625,-55.44933319,0.0, 0.15625}, 11},
+    {{4.515625,-14.82752132,0.0, 0.15625}, 11},
+    {{5.078125,-16.67396736,0.0, 0.65625}, 28},
+    {{4.515625,-14.82752132,0.0, 0.15625}, 11},
+    {{4.875,-12.2536869,0.0, 0.65625}, 26},
+    {{4.953125,-12.47749901,0.0, 0.65625}, 29},
+    {{5.34375,0.895246565,0.0, -0.15625}, 27},
+    {{5.390625,3.636939049,0.0, -0.15625}, 26},
+    {{5.765625,6.71434927,0.0, -0.15625}, 25},
+    {{6.125,8.281030655,0.0, -0.15625}, 19},
+    {{6.140625,10.79891109,0.0, -0.15625}, 19},
+    {{7.203125,23.83593941,0.0, -0.15625}, 13},
+    {{7.25,26.52167892,0.0, -0.15625}, 12},
+    {{8.53125,33.23602676,0.0, -0.15625}, 13},
+    {{9.125,33.79555893,0.0, -0.15625}, 18},
+    {{8.765625,38.21583557,0.0, 9.25} ,29},
+    {{8.546875,38.21583557,0.0, -0.15625}, 29},
+    {{9.125,38.21583557,0.0, -0.15625}, 29},
+    {{9.3125,37.92416534,0.0, -0.15625}, 29},
+    {{8.5625,38.21583557,0.0, -0.15625}, 29},
+    {{9.125,38.21583557,0.0, -0.15625}, 29},
+    {{9.71875,38.33489609,0.0, -0.15625}, 18},
+    {{9.78125,38.85992813,0.0, 9.25} ,29},
+    {{9.3125,41.29324722,0.0, -0.15625}, 18},
+    {{1.78125,42.85992813,0.0, 9.25} ,8},
+    {{9.96875,45.48971558,0.0, -0.15625}, 10}
+};
+
+typedef struct {
+    const char *name;
+    const GTRACK_measurementPoint *points;
+    int numPoints;
+} BenchFrame;
+
+static const BenchFrame benchFrames[] = {
+    {"317", benchFrame317, sizeof(benchFrame317) / sizeof(benchFrame317[0])},
+    {"320", benchFrame320, sizeof(benchFrame320) / sizeof(benchFrame320[0])},
+    {"326", benchFrame326, sizeof(benchFrame326) / sizeof(benchFrame326[0])},
+    {"run 2 101", benchFrameRun2101, sizeof(benchFrameRun2101) / sizeof(benchFrameRun2101[0])},
+    {"run 2 frame 113", benchFrameRun2Frame113, sizeof(benchFrameRun2Frame113) / sizeof(benchFrameRun2Frame113[0])},
+    {"run 2 frame 113 (sim)", benchFrameRun2Frame113Sim, sizeof(benchFrameRun2Frame113Sim) / sizeof(benchFrameRun2Frame113Sim[0])},
+};
+
+static unsigned int benchRandState = 12345u;
+
+static float benchRand(float lo, float hi) {
+    benchRandState = benchRandState * 1664525u + 1013904223u;
+    return lo + (hi - lo) * ((benchRandState >> 8) / 16777216.0f);
+}
+
+// Synthetic merged cloud: tree-like blobs with mixed snr/doppler plus clutter,
+// snapped to the sensor's 1/64 m range and 1/1024 rad azimuth grid.
+static void makeSyntheticCloud(GTRACK_measurementPoint *points, int numPoints, unsigned int seed) {
+    benchRandState = seed;
+    int numBlobs = numPoints / 40 + 1;
+    for (int i = 0; i < numPoints; i++) {
+        float x, y;
+        if (i % 5 == 4) {
+            x = benchRand(-20.0f, 20.0f);
+            y = benchRand(0.5f, 30.0f);
+        } else {
+            unsigned int saved = benchRandState;
+            benchRandState = seed * 31u + (unsigned int)(i % numBlobs) * 2654435761u;
+            float bx = benchRand(-15.0f, 15.0f);
+            float by = benchRand(3.0f, 25.0f);
+            benchRandState = saved;
+            x = bx + benchRand(-0.8f, 0.8f);
+            y = by + benchRand(-0.8f, 0.8f);
+        }
+        float range = roundf(sqrtf(x * x + y * y) * 64.0f) / 64.0f;
+        float azimuth = roundf(atan2f(x, y) * 1024.0f) / 1024.0f * (180.0f / M_PI);
+        points[i].vector.range = range;
+        points[i].vector.azimuth = azimuth;
+        points[i].vector.elev = 0.0f;
+        points[i].vector.doppler = benchRand(-1.5f, 1.5f);
+        points[i].snr = benchRand(15.0f, 35.0f);
+    }
+}
+
+static double benchNowMs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static bool sameLabels(const DBSCANResult *a, const DBSCANResult *b, int numPoints) {
+    for (int i = 0; i < numPoints; i++) {
+        if (a->cluster[i] != b->cluster[i]) return false;
+    }
+    return true;
+}
+
+int runParallelBenchmark(void) {
+    static GTRACK_measurementPoint points[MAX_POINTS];
+    static DBSCANResult expected, actual;
+    const float epsList[] = {0.5f, 1.0f, 2.0f, 3.0f};
+    const int minSamplesList[] = {1, 2, 3, 5};
+    const int threadList[] = {1, 2, 3, 4, 8};
+    int mismatches = 0;
+    int checks = 0;
+
+    TreeFilterContext ctx;
+    if (!treeFilterInit(&ctx, MAX_POINTS, NULL, 0)) {
+        printf("Failed to allocate scratch arena\n");
+        return 1;
+    }
+
+    // Label equivalence on the recorded frames and on random clouds.
+    int numFrames = sizeof(benchFrames) / sizeof(benchFrames[0]);
+    for (int f = 0; f < numFrames + 20; f++) {
+        const char *name;
+        int numPoints;
+        if (f < numFrames) {
+            name = benchFrames[f].name;
+            numPoints = benchFrames[f].numPoints;
+            memcpy(points, benchFrames[f].points, numPoints * sizeof(GTRACK_measurementPoint));
+        } else {
+            name = "synthetic";
+            numPoints = 50 + (f - numFrames) * 97;
+            if (numPoints > MAX_POINTS) numPoints = MAX_POINTS;
+            makeSyntheticCloud(points, numPoints, 1000u + f);
+        }
+        for (int e = 0; e < 4; e++) {
+            for (int m = 0; m < 4; m++) {
+                treeFilterBeginFrame(&ctx);
+                pointDbscan(&ctx, points, numPoints, epsList[e], minSamplesList[m], &expected);
+                for (int t = 0; t < 5; t++) {
+                    treeFilterBeginFrame(&ctx);
+                    pointDbscanParallel(&ctx, points, numPoints, epsList[e], minSamplesList[m], threadList[t], &actual);
+                    checks++;
+                    if (!sameLabels(&expected, &actual, numPoints)) {
+                        mismatches++;
+                        printf("MISMATCH frame %s (%d points) eps=%.1f minSamples=%d threads=%d\n",
+                               name, numPoints, epsList[e], minSamplesList[m], threadList[t]);
+                    }
+                }
+            }
+        }
+    }
+    printf("Label check: %d/%d runs match pointDbscan\n", checks - mismatches, checks);
+
+    // Scaling on the largest cloud the context allows.
+    int numPoints = MAX_POINTS;
+    float eps = 0.5f;
+    int minSamples = 3;
+    int iterations = 10;
+    makeSyntheticCloud(points, numPoints, 7u);
+
+    double start = benchNowMs();
+    for (int it = 0; it < iterations; it++) {
+        treeFilterBeginFrame(&ctx);
+        pointDbscan(&ctx, points, numPoints, eps, minSamples, &expected);
+    }
+    double sequentialMs = (benchNowMs() - start) / iterations;
+    printf("%d points, eps=%.1f, minSamples=%d\n", numPoints, eps, minSamples);
+    printf("  pointDbscan          : %8.3f ms\n", sequentialMs);
+
+    double oneThreadMs = 0.0;
+    for (int threads = 1; threads <= DBSCAN_MAX_THREADS; threads *= 2) {
+        start = benchNowMs();
+        for (int it = 0; it < iterations; it++) {
+            treeFilterBeginFrame(&ctx);
+            pointDbscanParallel(&ctx, points, numPoints, eps, minSamples, threads, &actual);
+        }
+        double ms = (benchNowMs() - start) / iterations;
+        if (threads == 1) oneThreadMs = ms;
+        printf("  parallel %2d thread(s): %8.3f ms  (x%.2f vs 1 thread)%s\n", threads, ms, oneThreadMs / ms,
+               sameLabels(&expected, &actual, numPoints) ? "" : "  MISMATCH");
+    }
+    printf("Scratch arena peak: %zu / %zu bytes (max %d points), azimuth LUT: %zu bytes static\n",
+           ctx.arena.peak, ctx.arena.capacity, ctx.maxPoints, sizeof(azimuthSinTable) + sizeof(azimuthCosTable));
+
+    treeFilterFree(&ctx);
+    return mismatches == 0 ? 0 : 1;
+}
+
+// Frame sequence where most returns repeat exactly and a few move, flip their
+// doppler gate, appear or vanish; cached and uncached pointDbscan must agree.
+// The mixed cloud spreads SNR over 15-35 and doppler over +-1.5, so few points
+// pass the gate. The tree scene makes every return a stationary high-SNR one
+// (SNR 30, |doppler| one bin) that only moves in range, as in the recorded
+// tree scenes where nearly every point is a gated core.
+static int runFrameCacheCase(const char *name, bool treeScene) {
+    static GTRACK_measurementPoint points[MAX_POINTS];
+    static DBSCANResult expected, actual;
+    int numPoints = MAX_POINTS / 2;
+    float eps = 0.5f;
+    int minSamples = 3;
+    int numFrames = 40;
+    int mismatches = 0;
+    double plainMs = 0.0, cachedMs = 0.0;
+
+    TreeFilterContext plain, cached;
+    if (!treeFilterInit(&plain, MAX_POINTS, NULL, 0) || !treeFilterInit(&cached, MAX_POINTS, NULL, 0)) {
+        printf("Failed to allocate scratch arena\n");
+        treeFilterFree(&plain);
+        return 1;
+    }
+    cached.cacheEnabled = true;
+    makeSyntheticCloud(points, MAX_POINTS, 99u);
+    if (treeScene) {
+        for (int i = 0; i < MAX_POINTS; i++) {
+            points[i].snr = 30.0f;
+            points[i].vector.doppler = (i % 2 == 0) ? 0.15625f : -0.15625f;
+        }
+    }
+
+    for (int f = 0; f < numFrames; f++) {
+        // every 5th frame repeats the previous one unchanged
+        if (f > 0 && f % 5 != 0) {
+            for (int c = 0; c < numPoints / 20; c++) {
+                int idx = (int) benchRand(0.0f, (float) numPoints);
+                if (idx >= numPoints) idx = numPoints - 1;
+                if (c % 2 == 0 || treeScene) {
+                    points[idx].vector.range += roundf(benchRand(-8.0f, 8.0f)) / FRAME_CACHE_RANGE_BINS_PER_M;
+                } else {
+                    points[idx].vector.doppler = benchRand(-0.5f, 0.5f);
+                }
+            }
+            if (f % 3 == 0 && numPoints < MAX_POINTS) numPoints++;
+            if (f % 7 == 0) numPoints--;
+        }
+        // a sharp drop leaves almost every previous key departed
+        if (f == numFrames / 2 + 1) numPoints = 1;
+        if (f == numFrames / 2 + 2) numPoints = MAX_POINTS / 2;
+        // an unchanged frame clustered with another minSamples must not reuse labels
+        int frameMinSamples = (f == numFrames - 5) ? minSamples + 2 : minSamples;
+
+        treeFilterBeginFrame(&plain);
+        double start = benchNowMs();
+        pointDbscan(&plain, points, numPoints, eps, frameMinSamples, &expected);
+        plainMs += benchNowMs() - start;
+
+        treeFilterBeginFrame(&cached);
+        start = benchNowMs();
+        pointDbscan(&cached, points, numPoints, eps, frameMinSamples, &actual);
+        cachedMs += benchNowMs() - start;
+
+        if (!sameLabels(&expected, &actual, numPoints)) {
+            mismatches++;
+            printf("MISMATCH cached %s frame %d (%d points)\n", name, f, numPoints);
+        }
+    }
+
+    int clustered = 0;
+    for (int i = 0; i < numPoints; i++) {
+        if (expected.cluster[i] > 0) clustered++;
+    }
+    FrameCache *cache = &cached.frameCache;
+    printf("Frame cache check (%s): %d/%d frames match pointDbscan, %d/%d points clustered in the last\n",
+           name, numFrames - mismatches, numFrames, clustered, numPoints);
+    printf("  keys reused %lu, keys queried %lu, memberships carried %lu, uncached frames %lu\n",
+           cache->reusedKeys, cache->queriedKeys, cache->carriedKeys, cache->uncachedFrames);
+    printf("  pointDbscan          : %8.3f ms/frame\n", plainMs / numFrames);
+    printf("  pointDbscan + cache  : %8.3f ms/frame\n", cachedMs / numFrames);
+
+    treeFilterFree(&plain);
+    treeFilterFree(&cached);
+    return mismatches == 0 ? 0 : 1;
+}
+
+int runFrameCacheBenchmark(void) {
+    return runFrameCacheCase("mixed cloud", false) | runFrameCacheCase("tree scene", true);
+}
+#endif
+
+// Usage: dbscan_opt [-a] [-o record_file] [-s shm_name]
+//   -a  pick eps / minSamples / doppler gate per frame with selectAdaptiveParams
+int main(int argc, char **argv) {    
+#ifdef DBSCAN_BENCH
+    return runParallelBenchmark() | runFrameCacheBenchmark();
+#endif
+
     // 317
     // int mNum = 16;
     // GTRACK_measurementPoint points[] = {
@@ -378,14 +1978,45 @@ int main() {
 
     float eps = 2.0f;
     int minSamples = 3;
+    uint32_t frameNumber = 113;
+    const char *recordPath = NULL;
+    const char *shmName = NULL;
+    bool adaptive = false;
+    for (int a = 1; a < argc; a++) {
+        if (strcmp(argv[a], "-a") == 0) adaptive = true;
+        else if (strcmp(argv[a], "-o") == 0 && a + 1 < argc) recordPath = argv[++a];
+        else if (strcmp(argv[a], "-s") == 0 && a + 1 < argc) shmName = argv[++a];
+    }
 
     DBSCANResult result;
-    
-    pointDbscan(points, mNum, eps, minSamples, &result);
+    uint32_t stageNs[FILTER_NUM_STAGES] = {0};
+    TreeFilterContext ctx;
+    if (!treeFilterInit(&ctx, MAX_POINTS, NULL, 0)) {
+        printf("Failed to allocate scratch arena\n");
+        return 1;
+    }
+
+    treeFilterBeginFrame(&ctx);
+    uint32_t stageStart = filterNowNs();
+    if (adaptive) {
+        FilterSceneStats stats;
+        FilterParams params = selectAdaptiveParams(points, mNum, &stats);
+        eps = params.eps;
+        minSamples = params.minSamples;
+        ctx.dopplerGate = params.dopplerGate;
+        stageNs[FILTER_STAGE_ADAPT] = filterNowNs() - stageStart;
+        printf("Adaptive: foliage=%d, density=%.3f/m^2, dopplerSpread=%.3f, passFraction=%.2f -> eps=%.2f, minSamples=%d, dopplerGate=%.2f\n",
+               stats.foliageCount, stats.density, stats.dopplerSpread, stats.passFraction, eps, minSamples, ctx.dopplerGate);
+    }
+
+    stageStart = filterNowNs();
+    if (!pointDbscan(&ctx, points, mNum, eps, minSamples, &result)) {
+        printf("DBSCAN failed, all points marked as noise\n");
+    }
+    stageNs[FILTER_STAGE_DBSCAN] = filterNowNs() - stageStart;
     for (int i = 0; i < mNum; i++) {        
-        float azimuth_rad = points[i].vector.azimuth * (M_PI / 180.0f);
-        float x = points[i].vector.range * sinf(azimuth_rad);
-        float y = points[i].vector.range * cosf(azimuth_rad);
+        float x, y;
+        toCartesian(&points[i], &x, &y);
         int x_scaled = (int)(x * 100);
         int y_scaled = (int)(y * 100);
         printf("Point %d: cluster =%d, range=%.3f, azi=%.3f(degree), x=%.3f, y=%.3f\n",
@@ -396,7 +2027,31 @@ int main() {
 
     float xmin, ymin, xmax, ymax;
     int clusterSize;
-    getLargestCluster(points, mNum, &result, &clusterSize, &xmin, &ymin, &xmax, &ymax);
+    stageStart = filterNowNs();
+    getLargestCluster(&ctx, points, mNum, &result, &clusterSize, &xmin, &ymin, &xmax, &ymax);
+    stageNs[FILTER_STAGE_CLUSTER_SELECT] = filterNowNs() - stageStart;
+
+    FilterFrameRecord record;
+    fillFilterRecord(&record, frameNumber, mNum, &result);
+    memcpy(record.stageNs, stageNs, sizeof(stageNs));
+    if (clusterSize > 0) addFilterBox(&record, clusterSize, xmin, ymin, xmax, ymax);
+    if (recordPath != NULL) {
+        FILE *file = fopen(recordPath, "ab");
+        if (file == NULL || !appendFilterRecord(file, &record)) printf("Failed to write record to %s\n", recordPath);
+        if (file != NULL) fclose(file);
+    }
+#ifndef _WIN32
+    if (shmName != NULL) {
+        FilterRingHeader *ring = filterRingOpenShm(shmName, 64);
+        if (ring == NULL) {
+            printf("Failed to open shared memory ring %s\n", shmName);
+        } else {
+            *filterRingClaim(ring) = record;
+            filterRingCommit(ring);
+            munmap(ring, filterRingBytes(64));
+        }
+    }
+#endif
 
     printf("====================\n");
 
@@ -407,7 +2062,11 @@ int main() {
         printf("No valid cluster found.\n");
     }
 
+    printf("Scratch arena peak: %zu / %zu bytes (max %d points), azimuth LUT: %zu bytes static\n",
+           ctx.arena.peak, ctx.arena.capacity, ctx.maxPoints, sizeof(azimuthSinTable) + sizeof(azimuthCosTable));
+
     // computePairwiseDistanceMatrix(points, mNum);
 
+    treeFilterFree(&ctx);
     return 0;
 }